@@ -0,0 +1,42 @@
+//*************************************************************************************
+//  Arduino synth V4.1
+//  Optimized audio driver, modulation engine, envelope engine.
+//
+//  Dzl/Illutron 2014
+//
+//*************************************************************************************
+
+/*
+ * Height channel sound generator for arduino.
+ *
+ * Song format, played by SoundMachine::playSong().
+ *
+ * A song is a byte array stored in flash. It is read one row at a time on each MIDI tick, so it only uses a few bytes of RAM.
+ * Each command is a byte, command in the high nibble and channel in the low one, followed by its parameters.
+ * A row is made of the notes to start on any channels, then SONG_ROW and the number of ticks (24 per quarter) to wait.
+ *
+ * Songs can be written by hand with the macros below, or made from a text or MIDI file with tools/song2h.py
+ */
+
+#ifndef SONG_H
+#define SONG_H
+
+#define SONG_NOTE           0x00        //+ channel, then note, (wave << 4) | env, length
+#define SONG_STOP           0x10        //+ channel
+#define SONG_ROW            0x20        //then ticks to wait before next row
+#define SONG_BPM            0x30        //then bpm
+#define SONG_MARK           0x40        //marks the start of a section to repeat
+#define SONG_REPEAT         0x50        //then count: plays again the section since the last mark count times
+#define SONG_JUMP           0x60        //then offset from the song start (2 bytes, low byte first)
+#define SONG_END            0xF0
+
+#define S_NOTE(ch, note, wave, env, length)     (SONG_NOTE | (ch)), (note), (((wave) << 4) | (env)), (length)
+#define S_STOP(ch)                              (SONG_STOP | (ch))
+#define S_ROW(ticks)                            SONG_ROW, (ticks)
+#define S_BPM(bpm)                              SONG_BPM, (bpm)
+#define S_MARK                                  SONG_MARK
+#define S_REPEAT(count)                         SONG_REPEAT, (count)
+#define S_JUMP(offset)                          SONG_JUMP, ((offset) & 0xFF), ((offset) >> 8)
+#define S_END                                   SONG_END
+
+#endif
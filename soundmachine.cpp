@@ -4,8 +4,12 @@
 volatile unsigned char lastPlay = 0;			// this remains what was the last channel played.
 
 volatile unsigned char current = CHANNELS;		// keeps the track of the channel beeing processed (see the ISR for more information)
+volatile unsigned char currentBit = 0x01;		// bit of the channel beeing processed, rotated along with current
+
+volatile unsigned int sampleCount = 0;			// Counter for ISR, used to time loop()
 
 volatile unsigned int tickCount = 0;			// Counter for ticks
+volatile unsigned int tickTotal = 0;			// Ticks since begin(), used to give the channels age
 volatile unsigned int tickTop = 0;
 volatile bool tick = false;
 
@@ -13,6 +17,8 @@ volatile unsigned char bpmCount = 0;
 volatile unsigned char bpmTop = 24;
 volatile bool tickBpm = false;
 
+volatile unsigned char songTicks = 0;			// ticks not yet processed by the song player
+
 volatile unsigned int waveAcc[CHANNELS];
 volatile unsigned int waveTune[CHANNELS];
 
@@ -22,11 +28,89 @@ volatile unsigned int envAcc[CHANNELS];
 volatile unsigned int envTune[CHANNELS];
 
 volatile unsigned int wave[CHANNELS];
+volatile unsigned char noiseMask = 0;			// channels playing noise, one bit per channel
+unsigned int noiseReg[CHANNELS];			// noise shift registers, one per channel
 volatile unsigned int env[CHANNELS];
 
 unsigned char pitch[CHANNELS];
 unsigned char length[CHANNELS];
+unsigned char waveform[CHANNELS];
+unsigned int playTick[CHANNELS];			// value of tickTotal when the channel was played
+
+volatile unsigned char fmMask = 0;			// carrier channels of the pairs played in FM, one bit per channel
+volatile unsigned char fmDepth[CHANNELS / 2];		// modulation depth of each pair, 0 to use the modulator enveloppe
+
+volatile unsigned char filterMode = FILTER_OFF;	// filter output used (low, high or band pass), or off
+volatile unsigned char filterMask = 0xFF;		// channels routed through the filter, one bit per channel
+volatile unsigned char filterF = 0;			// cutoff coefficient, see SoundMachine::setFilterCutoff()
+volatile unsigned char filterQ = 0xFF;			// damping coefficient, see SoundMachine::setFilterResonance()
+int32_t filterLow = 0;					// filter state: low pass and band pass outputs, see svf.h
+int32_t filterBand = 0;
+
+volatile unsigned int isrPeak = 0;			// longest ISR since last getIsrCycles() call, in CPU cycles
+volatile unsigned int governorPeak = 0;			// longest ISR since last governor check, in CPU cycles
+
+volatile unsigned char voiceMask = 0xFF;		// channels computed by the ISR, the others are shed by the governor
+volatile unsigned char fadeMask = 0;			// channels being faded out before being shed
+volatile unsigned int shedCount = 0;			// channels shed since setGovernor(), counted once faded out
+unsigned char fadeLevel[CHANNELS];			// fade out level of these channels
+
+//Compute the raw sample of channel n, from its wave table or from its noise generator.
+//offset is added to the table index, it is used for phase modulation (FM).
+//Noise is a 16 bits Galois LFSR, stepped each time the 5 top bits of the wave accumulator change: 32 steps per period.
+//The pitch sets the noise colour up to the note where it steps on every sample (note 76 at 20KHz, 66 at 11025Hz),
+//above that it is white noise. The output is scaled to the level of the former noise table (RMS of 75).
+static inline __attribute__((always_inline)) char _oscillator(const unsigned char n, unsigned char offset = 0){
+	unsigned char phase = ((unsigned char*)&(waveAcc[n]))[1];
+	unsigned char next = ((unsigned char*)&(waveAcc[n] += waveTune[n]))[1];
+
+	if(noiseMask & (1 << n)){
+		if((next ^ phase) & 0xF8){
+			noiseReg[n] = (noiseReg[n] >> 1) ^ (-(noiseReg[n] & 1) & 0xB400);
+		}
+		return (noiseReg[n] & 1) ? NOISE_LEVEL : -NOISE_LEVEL;
+	}
+
+	return pgm_read_byte(wave[n] + (unsigned char)(next + offset));
+}
+
+//Add the sample of channel n to the dry or to the filtered bus.
+static inline __attribute__((always_inline)) void _route(const unsigned char n, int sample, unsigned char mask, int &dry, int &wet){
+	if(mask & (1 << n)){
+		wet += sample;
+	} else {
+		dry += sample;
+	}
+}
+
+//Compute the sample of channel n and add it to the output.
+//It is always inlined and called with a constant n, so it compiles as the former unrolled sum did.
+static inline __attribute__((always_inline)) void _mix(const unsigned char n, unsigned char mask, int &dry, int &wet){
+	if(voiceMask & (1 << n)){
+		_route(n, (_oscillator(n) * waveAmp[n]) >> 8, mask, dry, wet);
+	}
+}
 
+//Compute the pair of channels c (even) and c + 1.
+//Channels shed by the governor are skipped, in FM the pair follows its carrier.
+//In FM, channel c + 1 is not heard: it modulates the phase of channel c, scaled by the pair depth or by its own enveloppe.
+//The offset is taken modulo the 256 steps of the table, the highest depth gives a deviation of about one period.
+static inline __attribute__((always_inline)) void _mixPair(const unsigned char c, unsigned char mask, int &dry, int &wet){
+	if(fmMask & (1 << c)){
+		if(!(voiceMask & (1 << c))){
+			return;
+		}
+		unsigned char depth = fmDepth[c / 2];
+		if(!depth){
+			depth = waveAmp[c + 1];
+		}
+		unsigned char offset = (_oscillator(c + 1) * depth) >> 7;
+		_route(c, (_oscillator(c, offset) * waveAmp[c]) >> 8, mask, dry, wet);
+	} else {
+		_mix(c, mask, dry, wet);
+		_mix(c + 1, mask, dry, wet);
+	}
+}
 
 
 //This is the Interrupt routine. It's fired on a regular basis, given the sampling and CPU frequencies.
@@ -40,6 +124,8 @@ ISR(TIMER1_COMPA_vect){
 	if(tickCount >= tickTop){
 		tickCount = 0;
 		tick = true;
+		tickTotal++;
+		songTicks++;
 		bpmCount++;
 		//if top is reached, set back to 0 and set a flag (tickBpm)
 		if(bpmCount >= bpmTop){
@@ -48,8 +134,11 @@ ISR(TIMER1_COMPA_vect){
 		}
 	}
 
+	sampleCount++;
+
 	current++;
 	current &= 0x07;
+	currentBit = (currentBit << 1) | (currentBit >> 7);
 
 	//Channels amplitude are processed one at each ISR.
 	//It gives a bit more room for other things to happend between two ISR.
@@ -60,43 +149,107 @@ ISR(TIMER1_COMPA_vect){
 		waveAmp[current] = 0;				// if the envAcc overlaps the enveloppe table lenght, then volume is set to 0.
 	}
 
+	//Channels shed by the governor are faded out first, then stopped and no longer computed
+	if(fadeMask & currentBit){
+		unsigned char level = fadeLevel[current];
+		if(level > GOVERNOR_FADE_STEP){
+			fadeLevel[current] = level - GOVERNOR_FADE_STEP;
+			waveAmp[current] = (waveAmp[current] * level) >> 8;
+		} else {
+			envAcc[current] = 0x8000;
+			waveAmp[current] = 0;
+			fadeMask &= ~currentBit;
+			voiceMask &= ~currentBit;
+			shedCount++;
+		}
+	}
+
+	//Here each channels are added to compute the value of the PWM output pin.
+	//Channels routed to the filter are added on their own bus (wet), the others go straight to the output (dry)
+	int dry = 0;
+	int wet = 0;
+	unsigned char mask = filterMode ? filterMask : 0;
+
+	_mixPair(0, mask, dry, wet);
+	_mixPair(2, mask, dry, wet);
+	_mixPair(4, mask, dry, wet);
+	_mixPair(6, mask, dry, wet);
+
+	int out = dry / 4;
+
+	//State variable filter, see svf.h
+	if(mask){
+		out += svfProcess(filterLow, filterBand, filterF, filterQ, filterMode, wet / 4);
+	}
+
+	//Resonance can push the output out of the PWM range, so it is clipped.
+	out += 127;
+	if(out < 0){
+		out = 0;
+	} else if(out > 255){
+		out = 255;
+	}
+
 	//Timer that drives PWM on output pin is not the same on Arduino Uno and leonardo/micro.
 	#if defined(__AVR_ATmega32U4__)
-	OCR4A = OCR4B = 127 +
+	OCR4A = OCR4B = out;
 	#else
-	OCR2A = 127 +
+	OCR2A = out;
 	#endif
-	//Here each channels are added to compute the value of the PWM output pin
-	(
-	(((char)pgm_read_byte(wave[0] + ((unsigned char*)&(waveAcc[0] += waveTune[0]))[1]) * waveAmp[0]) >> 8) +
-	(((char)pgm_read_byte(wave[1] + ((unsigned char*)&(waveAcc[1] += waveTune[1]))[1]) * waveAmp[1]) >> 8) +
-	(((char)pgm_read_byte(wave[2] + ((unsigned char*)&(waveAcc[2] += waveTune[2]))[1]) * waveAmp[2]) >> 8) +
-	(((char)pgm_read_byte(wave[3] + ((unsigned char*)&(waveAcc[3] += waveTune[3]))[1]) * waveAmp[3]) >> 8) +
-	(((char)pgm_read_byte(wave[4] + ((unsigned char*)&(waveAcc[4] += waveTune[4]))[1]) * waveAmp[4]) >> 8) +
-	(((char)pgm_read_byte(wave[5] + ((unsigned char*)&(waveAcc[5] += waveTune[5]))[1]) * waveAmp[5]) >> 8) +
-	(((char)pgm_read_byte(wave[6] + ((unsigned char*)&(waveAcc[6] += waveTune[6]))[1]) * waveAmp[6]) >> 8) +
-	(((char)pgm_read_byte(wave[7] + ((unsigned char*)&(waveAcc[7] += waveTune[7]))[1]) * waveAmp[7]) >> 8)
-	) / 4;
+
+	//Timer 1 is cleared on compare match, so its value gives the number of CPU cycles spent since the ISR was fired.
+	//If the ISR lasted more than a sample, the timer wrapped: the compare flag is set again, and a whole period is added.
+	unsigned int cycles = TCNT1;
+	if(TIFR1 & (1 << OCF1A)){
+		cycles += CPU / SAMPLING;
+	}
+	if(cycles > isrPeak){
+		isrPeak = cycles;
+	}
+	if(cycles > governorPeak){
+		governorPeak = cycles;
+	}
 
 }
 
 //class constructor
 SoundMachine::SoundMachine(void){
-
+	songStart = NULL;
+	songPos = NULL;
+	governorIsr = 0;
+	governorLoop = 0;
+	governorStats.dropped = 0;
 }
 
 //Start the synth. Set default bpm and signature, init timers
 void SoundMachine::begin(){
 	for(int i = 0; i < CHANNELS; i++){
 		envAcc[i] = 0x8000;
+		noiseReg[i] = 0xACE1 + i;			// any non zero seed will do
 	}
 	setBpm(60);
 	setSignature(4);
 	_isrInit();
 }
 
+/*
+ * update function. Must be called from loop(), as often as possible.
+ * It runs the song player for each tick elapsed since last call, and the governor. Returns the number of ticks processed.
+ */
 int SoundMachine::update(){
+	_governor();
+
+	//songTicks is written by the ISR: read it and clear it at once
+	cli();
+	unsigned char ticks = songTicks;
+	songTicks = 0;
+	sei();
+
+	for(unsigned char i = 0; i < ticks; i++){
+		_songStep();
+	}
 
+	return ticks;
 }
 
 //Timer initialisation.
@@ -190,10 +343,12 @@ void SoundMachine::setVoice(unsigned char i, unsigned char wave, unsigned char p
 }
 
 /*
- * setWave function. It records on wave[] a pointer to the wave table wanted
+ * setWave function. It records on wave[] a pointer to the wave table wanted, or flags the channel as noise
  */
 void SoundMachine::_setWave(unsigned char i, unsigned char _wave){
 
+	waveform[i] = _wave > NOISE ? SIN : _wave;		// unknown waves are played as SIN
+
 	switch(_wave){
 		case TRI:
 			wave[i] = (unsigned int)triTable;
@@ -204,13 +359,17 @@ void SoundMachine::_setWave(unsigned char i, unsigned char _wave){
 		case SAW:
 			wave[i] = (unsigned int)sawTable;
 			break;
-		case NOISE:
-			wave[i] = (unsigned int)noiseTable;
-			break;
 		default:
 			wave[i] = (unsigned int)sinTable;
 	}
 
+	//Noise has no table, it is generated by the ISR
+	if(_wave == NOISE){
+		noiseMask |= (1 << i);
+	} else {
+		noiseMask &= ~(1 << i);
+	}
+
 }
 
 /*
@@ -270,15 +429,29 @@ void SoundMachine::play(unsigned char i){
 
 	lastPlay = i;
 
-	waveAcc[i] = 0;
-	envAcc[i] = 0;
+	//A fade out started by the governor would cut the new note: it is cancelled.
+	//A channel shed by the governor is not computed: its enveloppe is not started, so the channel stays inactive
+	//and does not pop in halfway through the note when it is brought back.
+	cli();
+	playTick[i] = tickTotal;
+	fadeMask &= ~(1 << i);
+	bool shed = !(voiceMask & (1 << i));
+	if(!shed){
+		waveAcc[i] = 0;
+		envAcc[i] = 0;
+	}
+	sei();
+
+	if(shed){
+		governorStats.dropped++;
+	}
 
 }
 
 //Direct play of a note with parameters
 unsigned char SoundMachine::play(unsigned char wave, unsigned char pitch, unsigned char env, unsigned char length){
 	//Get the new channel to play
-	unsigned char current = lastPlay + 1;
+	unsigned char current = getNextPlay();
 
 	//Set voice, then play it.
 	setVoice(current, wave, pitch, env, length);
@@ -290,27 +463,33 @@ unsigned char SoundMachine::play(unsigned char wave, unsigned char pitch, unsign
 
 //stop a note that is being played
 void SoundMachine::stop(unsigned char i){
-	waveAcc[i] = 0x8000;
+	envAcc[i & 0x7] = 0x8000;
 }
 
 /*
  * getNextPlay function. This function gives the last channel whom play has been started, + 1. (i.e. if the last channel played was 2, function returns 3)
+ * Channels shed by the governor are skipped.
  */
 unsigned char SoundMachine::getNextPlay(void){
-		return (lastPlay + 1) & 0x7;
+	unsigned char next = (lastPlay + 1) & 0x7;
+	for(unsigned char i = 0; i < CHANNELS && !(voiceMask & (1 << next)); i++){
+		next = (next + 1) & 0x7;
+	}
+	return next;
 }
 
 /*
  * getNextChannel function. This function gives the number of the channel whom play is more advanced.
  * it's a bit like getNextPlay, but it makes the difference between a sound that is played fast and a sound that lasts longer.
  * taht way if the user wants to play a sound as all the channels are already used, it can choose the one on which the sound is the closer to the end.
+ * Channels shed by the governor are skipped.
  */
 unsigned char SoundMachine::getNextChannel(void){
 
-	byte nextChannel=0;
+	byte nextChannel = (voiceMask & 0x01) ? 0 : getNextPlay();
 	byte lastWaveAmp=255;
 	for(byte i=0; i<8; i++){
-		if(envAcc[i] > 0x4000 && waveAmp[i] < lastWaveAmp){		// for sounds that have played more than half, sorts those which wave amplitude are the lowest
+		if((voiceMask & (1 << i)) && envAcc[i] > 0x4000 && waveAmp[i] < lastWaveAmp){		// for sounds that have played more than half, sorts those which wave amplitude are the lowest
 			lastWaveAmp = envAcc[i];
 			nextChannel=i;
 		}
@@ -393,4 +572,412 @@ bool SoundMachine::getBeat(){
 		return true;
 	}
 
-}
\ No newline at end of file
+}
+
+/*
+ * setFilter function. Sets the filter mode, cutoff and resonance in one call.
+ *
+ * mode is the filter output to use 						[FILTER_OFF, FILTER_LOWPASS, FILTER_HIGHPASS, FILTER_BANDPASS]
+ * cutoff is the cutoff frequency, as a MIDI note 			[0..127]
+ * resonance is the amount of resonance 					[0..255]
+ */
+void SoundMachine::setFilter(unsigned char mode, unsigned char cutoff, unsigned char resonance){
+	setFilterCutoff(cutoff);
+	setFilterResonance(resonance);
+
+	//Filter state is cleared when the filter is switched, so it starts from silence
+	cli();
+	filterLow = 0;
+	filterBand = 0;
+	filterMode = mode;
+	sei();
+}
+
+/*
+ * setFilterCutoff function. Computes the cutoff coefficient from a MIDI note.
+ * pitchTable already holds fc * 65536 / fs for each note, so 2.sin(PI.fc/fs) * 256 is about pitchTable * 2PI / 256
+ * This is done only when the cutoff changes, so it can be called at each tick to make sweeps.
+ * The coefficient is a single byte, so the ISR never reads a half written value.
+ */
+void SoundMachine::setFilterCutoff(unsigned char cutoff){
+	unsigned long f = ((unsigned long)pgm_read_word(&pitchTable[cutoff & 0x7F]) * 201) >> 13;
+	if(f > FILTER_F_MAX){
+		f = FILTER_F_MAX;					// above fs / 8 or so the filter would become unstable
+	} else if(f < 1){
+		f = 1;							// notes under 8 would give 0, which freezes the filter
+	}
+	filterF = f;
+}
+
+/*
+ * setFilterResonance function. Computes the damping coefficient (1/Q * 128) from the resonance.
+ * 0 gives a Q of 0.5, 255 gives the highest Q the filter can handle without screaming.
+ */
+void SoundMachine::setFilterResonance(unsigned char resonance){
+	unsigned char q = 255 - resonance;
+	if(q < FILTER_Q_MIN){
+		q = FILTER_Q_MIN;
+	}
+	filterQ = q;
+}
+
+/*
+ * setFilterVoices function. Chooses which channels are routed through the filter, one bit per channel.
+ * Default is 0xFF: the filter is on the master output.
+ */
+void SoundMachine::setFilterVoices(unsigned char mask){
+	filterMask = mask;
+}
+
+/*
+ * getIsrCycles function. Gives the longest ISR duration since last call, in CPU cycles, then clears it.
+ * CPU / SAMPLING cycles are available between two ISR (800 at 20KHz), the remaining is left for loop().
+ */
+unsigned int SoundMachine::getIsrCycles(void){
+	cli();
+	unsigned int cycles = isrPeak;
+	isrPeak = 0;
+	sei();
+	return cycles;
+}
+
+
+/*
+ * getState function. Copies the state of all the channels and of the tick counters.
+ * Values written by the ISR are copied with interrupts off, so they are all from the same sample and no 16 bits value is torn.
+ * Interrupts are only off while copying, well under one sample period.
+ */
+void SoundMachine::getState(SynthState &state){
+	unsigned int ticks;
+
+	cli();
+	for(unsigned char i = 0; i < CHANNELS; i++){
+		state.voice[i].amp = waveAmp[i];
+		state.voice[i].envPos = envAcc[i];
+	}
+	ticks = tickTotal;
+	state.tickCount = tickCount;
+	state.bpmCount = bpmCount;
+	sei();
+
+	state.ticks = ticks;
+	state.active = 0;
+	for(unsigned char i = 0; i < CHANNELS; i++){
+		VoiceState &voice = state.voice[i];
+		voice.active = !(voice.envPos & 0x8000);
+		voice.note = pitch[i];
+		voice.wave = waveform[i];
+		voice.age = ticks - playTick[i];
+		if(voice.active){
+			state.active |= (1 << i);
+		}
+	}
+}
+
+/*
+ * dumpState function. Sends a snapshot of the state in binary, for tools/statemon.py. Each frame is:
+ * STATE_SYNC1, STATE_SYNC2, ticks (2 bytes, low byte first), ticks in the current beat, active channels,
+ * then for each channel: amplitude, enveloppe position [0..128], note [0..127], wave [0..4], age in ticks (255 if older),
+ * then a checksum: the sum of all the bytes after the sync, modulo 256.
+ * Sync bytes can also appear in the payload, the checksum lets the reader find the real start of the frames.
+ */
+void SoundMachine::dumpState(Print &out){
+	SynthState state;
+	unsigned char frame[STATE_FRAME_SIZE];
+	unsigned char *p = frame;
+	unsigned char sum = 0;
+
+	getState(state);
+
+	*p++ = STATE_SYNC1;
+	*p++ = STATE_SYNC2;
+	*p++ = state.ticks & 0xFF;
+	*p++ = state.ticks >> 8;
+	*p++ = state.bpmCount;
+	*p++ = state.active;
+	for(unsigned char i = 0; i < CHANNELS; i++){
+		*p++ = state.voice[i].amp;
+		*p++ = state.voice[i].envPos >> 8;
+		*p++ = state.voice[i].note & 0x7F;
+		*p++ = state.voice[i].wave;
+		*p++ = state.voice[i].age > 255 ? 255 : state.voice[i].age;
+	}
+
+	for(unsigned char *q = frame + 2; q < p; q++){
+		sum += *q;
+	}
+	*p = sum;
+
+	out.write(frame, sizeof(frame));
+}
+
+/*
+ * setFM function. Plays the pair of channels holding channel i in FM: the odd channel modulates the phase of the even one.
+ * Both channels are set and played as usual, the modulator pitch gives the timbre (same pitch for brass, x2 for basses,
+ * non integer ratios for bells) and the modulator channel is not heard by itself.
+ *
+ * i is a channel of the pair 							[0..7]
+ * depth is the modulation index 						[0..255], 0 to follow the modulator enveloppe
+ */
+void SoundMachine::setFM(unsigned char i, unsigned char depth){
+	i &= 0x6;
+	fmDepth[i / 2] = depth;
+	fmMask |= (1 << i);
+}
+
+//Set the pair holding channel i back to two plain channels
+void SoundMachine::clearFM(unsigned char i){
+	fmMask &= ~(1 << (i & 0x6));
+}
+
+/*
+ * playSong function. Starts playing a song stored in flash (see song.h for the format). First row is played on next tick.
+ */
+void SoundMachine::playSong(const unsigned char* song){
+	songStart = song;
+	songPos = song;
+	songMark = song;
+	songWait = 0;
+	songRepeat = 0;
+
+	//Ticks elapsed before the song starts (i.e. during setup()) must not be played at once
+	cli();
+	songTicks = 0;
+	sei();
+}
+
+//Stop the song. Notes already started are left to end by themselves.
+void SoundMachine::stopSong(void){
+	songPos = NULL;
+}
+
+//Tells if a song is being played
+bool SoundMachine::isSongPlaying(void){
+	return songPos != NULL;
+}
+
+/*
+ * _songStep function. Called on each tick. Once the wait of the previous row is over, it reads commands up to the next row.
+ * A section with no SONG_ROW between a SONG_JUMP and its target would loop forever.
+ */
+void SoundMachine::_songStep(void){
+	if(songPos == NULL){
+		return;
+	}
+
+	if(songWait > 1){
+		songWait--;
+		return;
+	}
+
+	while(true){
+		unsigned char cmd = pgm_read_byte(songPos++);
+		unsigned char note, waveEnv, length, count;
+		unsigned int offset;
+
+		switch(cmd & 0xF0){
+			case SONG_NOTE:
+				note = pgm_read_byte(songPos++);
+				waveEnv = pgm_read_byte(songPos++);
+				length = pgm_read_byte(songPos++);
+				setVoice(cmd, waveEnv >> 4, note, waveEnv & 0x0F, length);
+				play(cmd);
+				break;
+			case SONG_STOP:
+				stop(cmd);
+				break;
+			case SONG_ROW:
+				songWait = pgm_read_byte(songPos++);
+				if(songWait){
+					return;
+				}
+				break;
+			case SONG_BPM:
+				setBpm(pgm_read_byte(songPos++));
+				break;
+			case SONG_MARK:
+				songMark = songPos;
+				songRepeat = 0;
+				break;
+			case SONG_REPEAT:
+				count = pgm_read_byte(songPos++);
+				if(songRepeat < count){
+					songRepeat++;
+					songPos = songMark;
+				} else {
+					songRepeat = 0;
+				}
+				break;
+			case SONG_JUMP:
+				offset = pgm_read_byte(songPos);
+				offset |= pgm_read_byte(songPos + 1) << 8;
+				songPos = songStart + offset;
+				break;
+			default:
+				songPos = NULL;
+				return;
+		}
+	}
+}
+
+/*
+ * setGovernor function. The governor sheds channels when the CPU is short, and brings them back when it is not anymore.
+ * It is run by update(), so update() must be called from loop().
+ *
+ * isrBudget is the highest ISR duration allowed, in percent of the time between two samples 	[0..100], 0 disables the governor
+ * loopBudget is the longest time allowed between two calls to update(), in ms 				[0..255], 0 to not check it
+ */
+void SoundMachine::setGovernor(unsigned char isrBudget, unsigned char loopBudget){
+	governorIsr = (unsigned long)(CPU / SAMPLING) * isrBudget / 100;
+	governorLoop = (unsigned long)loopBudget * SAMPLING / 1000;
+	governorGap = 0;
+	governorCalm = 0;
+	governorStats.overBudget = 0;
+	governorStats.restored = 0;
+	governorStats.dropped = 0;
+	governorStats.isrPeak = 0;
+	governorStats.loopPeak = 0;
+
+	cli();
+	governorLast = governorUpdate = sampleCount;
+	governorPeak = 0;
+	shedCount = 0;
+	sei();
+
+	//With the governor off, every channel is brought back at once
+	if(!governorIsr){
+		cli();
+		fadeMask = 0;
+		voiceMask = 0xFF;
+		sei();
+	}
+}
+
+/*
+ * getGovernorStats function. Copies the governor counters. Peaks are the highest values since last call, then cleared.
+ */
+void SoundMachine::getGovernorStats(GovernorStats &stats){
+	stats = governorStats;
+
+	cli();
+	stats.shed = shedCount;
+	sei();
+
+	//Voices are counted as _shedVoice() does: a FM pair is one voice
+	stats.voices = 0;
+	for(unsigned char i = 0; i < CHANNELS; i++){
+		if((i & 1) && (fmMask & (1 << (i - 1)))){
+			continue;
+		}
+		if(voiceMask & (1 << i)){
+			stats.voices++;
+		}
+	}
+	governorStats.isrPeak = 0;
+	governorStats.loopPeak = 0;
+}
+
+/*
+ * _governor function. Called by update(). It measures the time since last call, and every GOVERNOR_PERIOD samples
+ * compares it and the longest ISR with the budgets.
+ * Over budget, it fades out one channel, the quietest first. Once back under 3/4 of the budget for GOVERNOR_HOLD periods,
+ * it brings one channel back.
+ */
+void SoundMachine::_governor(void){
+	if(!governorIsr){
+		return;
+	}
+
+	cli();
+	unsigned int now = sampleCount;
+	sei();
+
+	unsigned int gap = now - governorUpdate;
+	governorUpdate = now;
+	if(gap > governorGap){
+		governorGap = gap;
+	}
+
+	if(now - governorLast < GOVERNOR_PERIOD){
+		return;
+	}
+	governorLast = now;
+
+	cli();
+	unsigned int peak = governorPeak;
+	governorPeak = 0;
+	sei();
+
+	gap = governorGap;
+	governorGap = 0;
+
+	if(peak > governorStats.isrPeak){
+		governorStats.isrPeak = peak;
+	}
+	if(gap > governorStats.loopPeak){
+		governorStats.loopPeak = gap;
+	}
+
+	bool late = governorLoop && gap > governorLoop;
+
+	if(peak > governorIsr || late){
+		governorStats.overBudget++;
+		governorCalm = 0;
+		//Wait for the previous channel to be faded out before shedding another one
+		if(!fadeMask){
+			_shedVoice();
+		}
+	} else if(peak < governorIsr - governorIsr / 4 && (!governorLoop || gap < governorLoop - governorLoop / 4)){
+		if(++governorCalm >= GOVERNOR_HOLD){
+			governorCalm = 0;
+			for(unsigned char i = 0; i < CHANNELS; i++){
+				if(!(voiceMask & (1 << i))){
+					cli();
+					voiceMask |= (1 << i);
+					sei();
+					governorStats.restored++;
+					break;
+				}
+			}
+		}
+	} else {
+		governorCalm = 0;
+	}
+}
+
+/*
+ * _shedVoice function. Picks the channel to shed: a silent one if any, else the quietest.
+ * A FM pair counts as one voice and goes with its carrier. At least GOVERNOR_MIN_VOICES voices are kept.
+ * Returns false if no channel can be shed.
+ */
+bool SoundMachine::_shedVoice(void){
+	unsigned char voices = 0;
+	unsigned char channel = CHANNELS;
+	unsigned char quietest = 255;
+
+	for(unsigned char i = 0; i < CHANNELS; i++){
+		if(!(voiceMask & (1 << i))){
+			continue;
+		}
+		//A FM pair is one voice: its modulator is neither counted nor shed, the pair goes with its carrier
+		if((i & 1) && (fmMask & (1 << (i - 1)))){
+			continue;
+		}
+		voices++;
+		unsigned char amp = (envAcc[i] & 0x8000) ? 0 : waveAmp[i];
+		if(channel == CHANNELS || amp < quietest){
+			quietest = amp;
+			channel = i;
+		}
+	}
+
+	if(channel == CHANNELS || voices <= GOVERNOR_MIN_VOICES){
+		return false;
+	}
+
+	cli();
+	fadeLevel[channel] = 255;
+	fadeMask |= (1 << channel);
+	sei();
+	return true;
+}
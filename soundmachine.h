@@ -32,6 +32,8 @@
 //We need the SAMPLING value to be defined in order to set the right tables
 //So tables must be included now.
 #include "tables.h"
+#include "song.h"
+#include "svf.h"
 
 #define CHANNELS            8
 
@@ -41,6 +43,47 @@
 #define SAW                 3
 #define NOISE               4
 
+#define NOISE_LEVEL         75          //amplitude of the noise generator, same loudness as the former noise table
+
+#define GOVERNOR_PERIOD     (SAMPLING / 50)     //samples between two governor checks (20ms)
+#define GOVERNOR_HOLD       25          //checks under budget before a channel is brought back
+#define GOVERNOR_MIN_VOICES 2           //channels never shed
+#define GOVERNOR_FADE_STEP  8           //fade out speed of shed channels: 255 / 8 steps of 8 samples, about 13ms at 20KHz
+
+#define STATE_SYNC1         0xA5        //first two bytes of each frame sent by dumpState()
+#define STATE_SYNC2         0x5A
+#define STATE_FRAME_SIZE    (7 + CHANNELS * 5)
+
+//State of a channel, as copied by SoundMachine::getState()
+struct VoiceState{
+    bool active;                        //enveloppe is being played
+    unsigned char amp;                  //current amplitude [0..255]
+    unsigned int envPos;                //enveloppe accumulator, 0x8000 at the end of the enveloppe
+    unsigned char note;
+    unsigned char wave;
+    unsigned int age;                   //ticks since the channel was played
+};
+
+//State of the synth, as copied by SoundMachine::getState()
+struct SynthState{
+    VoiceState voice[CHANNELS];
+    unsigned char active;               //active channels, one bit per channel
+    unsigned int ticks;                 //ticks since begin()
+    unsigned int tickCount;             //ISR count in the current tick
+    unsigned char bpmCount;             //ticks in the current beat
+};
+
+//Governor counters, as copied by SoundMachine::getGovernorStats()
+struct GovernorStats{
+    unsigned int overBudget;            //checks over budget
+    unsigned int shed;                  //channels shed, counted once faded out
+    unsigned int restored;              //channels brought back
+    unsigned int dropped;               //notes played on shed channels, so not heard
+    unsigned int isrPeak;               //longest ISR, in CPU cycles
+    unsigned int loopPeak;              //longest time between two update() calls, in samples
+    unsigned char voices;               //voices currently computed, a FM pair counts as one
+};
+
 class SoundMachine{
   public:
     SoundMachine();
@@ -63,6 +106,25 @@ class SoundMachine{
     unsigned char getSignature();
     bool getBeat(void);
 
+    void setFilter(unsigned char mode, unsigned char cutoff, unsigned char resonance);
+    void setFilterCutoff(unsigned char cutoff);
+    void setFilterResonance(unsigned char resonance);
+    void setFilterVoices(unsigned char mask);
+    unsigned int getIsrCycles(void);
+
+    void getState(SynthState &state);
+    void dumpState(Print &out);
+
+    void setGovernor(unsigned char isrBudget, unsigned char loopBudget);
+    void getGovernorStats(GovernorStats &stats);
+
+    void setFM(unsigned char i, unsigned char depth);
+    void clearFM(unsigned char i);
+
+    void playSong(const unsigned char* song);
+    void stopSong(void);
+    bool isSongPlaying(void);
+
 protected:
     void _isrInit(void);
     void _bufferInit(void);
@@ -70,8 +132,25 @@ protected:
     void _setPitch(unsigned char i, unsigned char pitch);
     void _setEnv(unsigned char i, unsigned char env);
     void _setLength(unsigned char i, unsigned char length);
+    void _songStep(void);
+    void _governor(void);
+    bool _shedVoice(void);
 
     unsigned char bpm;
+
+    const unsigned char* songStart;     //song being played, NULL if none
+    const unsigned char* songPos;       //next command to read
+    const unsigned char* songMark;      //start of the section to repeat
+    unsigned char songWait;             //ticks left before next row
+    unsigned char songRepeat;           //times the section has been repeated
+
+    unsigned int governorIsr;           //ISR budget in CPU cycles, 0 if the governor is off
+    unsigned int governorLoop;          //update() budget in samples, 0 if not checked
+    unsigned int governorLast;          //sample count at last check
+    unsigned int governorUpdate;        //sample count at last update()
+    unsigned int governorGap;           //longest time between two update() since last check
+    unsigned char governorCalm;         //checks under budget in a row
+    GovernorStats governorStats;
 };
 
 #endif
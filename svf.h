@@ -0,0 +1,62 @@
+//*************************************************************************************
+//  Arduino synth V4.1
+//  Optimized audio driver, modulation engine, envelope engine.
+//
+//  Dzl/Illutron 2014
+//
+//*************************************************************************************
+
+/*
+ * Height channel sound generator for arduino.
+ *
+ * State variable filter (Chamberlin), run by the ISR on the filtered bus.
+ *
+ * It has no dependency on Arduino, so tools/svfcheck.cpp can run the exact same code on the host.
+ */
+
+#ifndef SVF_H
+#define SVF_H
+
+#include <stdint.h>
+
+#define FILTER_OFF          0
+#define FILTER_LOWPASS      1
+#define FILTER_HIGHPASS     2
+#define FILTER_BANDPASS     3
+
+#define FILTER_F_MAX        200         //highest cutoff coefficient, keeps the filter stable
+#define FILTER_Q_MIN        10          //lowest damping coefficient, sets the highest resonance
+
+#define FILTER_FRACTION     11          //fractional bits of the filter state
+
+//Type of the filter state. tools/svfcheck.cpp replaces it by a type that checks each value fits in 32 bits.
+#ifndef SVF_INT
+#define SVF_INT             int32_t
+#endif
+
+/*
+ * Runs the filter for one sample and returns the output of the given mode.
+ * low and band are the filter state, scaled by 2^FILTER_FRACTION. Without these fractional bits the integrators
+ * would get stuck on small values at low cutoffs, leaving a DC offset once the input is silent.
+ * Coefficients are fix point: f is 2.sin(PI.fc/fs) * 256, q is 1/Q * 128. Products are rounded to the nearest.
+ * The ISR input is in [-256..252]. At resonance, with f = FILTER_F_MAX and q = FILTER_Q_MIN, the largest product
+ * reaches about 63% of the 32 bits range: FILTER_FRACTION can not be raised without lowering FILTER_F_MAX or raising
+ * FILTER_Q_MIN, tools/svfcheck.cpp checks it.
+ */
+static inline __attribute__((always_inline)) int svfProcess(SVF_INT &low, SVF_INT &band, uint8_t f, uint8_t q, uint8_t mode, int in){
+	low += ((SVF_INT)f * band + 128) >> 8;
+	SVF_INT high = ((SVF_INT)in << FILTER_FRACTION) - low - (((SVF_INT)q * band + 64) >> 7);
+	band += ((SVF_INT)f * high + 128) >> 8;
+
+	SVF_INT out;
+	if(mode == FILTER_LOWPASS){
+		out = low;
+	} else if(mode == FILTER_HIGHPASS){
+		out = high;
+	} else {
+		out = band;
+	}
+	return (int)((out + ((SVF_INT)1 << (FILTER_FRACTION - 1))) >> FILTER_FRACTION);
+}
+
+#endif
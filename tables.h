@@ -39,9 +39,6 @@ const char sawTable[] PROGMEM = {
 	127,126,125,124,123,122,121,120,119,118,117,116,115,114,113,112,111,110,109,108,107,106,105,104,103,102,101,100,99,98,97,96,95,94,93,92,91,90,89,88,87,86,85,84,83,82,81,80,79,78,77,76,75,74,73,72,71,70,69,68,67,66,65,64,63,62,61,60,59,58,57,56,55,54,53,52,51,50,49,48,47,46,45,44,43,42,41,40,39,38,37,36,35,34,33,32,31,30,29,28,27,26,25,24,23,22,21,20,19,18,17,16,15,14,13,12,11,10,9,8,7,6,5,4,3,2,1,0,-1,-2,-3,-4,-5,-6,-7,-8,-9,-10,-11,-12,-13,-14,-15,-16,-17,-18,-19,-20,-21,-22,-23,-24,-25,-26,-27,-28,-29,-30,-31,-32,-33,-34,-35,-36,-37,-38,-39,-40,-41,-42,-43,-44,-45,-46,-47,-48,-49,-50,-51,-52,-53,-54,-55,-56,-57,-58,-59,-60,-61,-62,-63,-64,-65,-66,-67,-68,-69,-70,-71,-72,-73,-74,-75,-76,-77,-78,-79,-80,-81,-82,-83,-84,-85,-86,-87,-88,-89,-90,-91,-92,-93,-94,-95,-96,-97,-98,-99,-100,-101,-102,-103,-104,-105,-106,-107,-108,-109,-110,-111,-112,-113,-114,-115,-116,-117,-118,-119,-120,-121,-122,-123,-124,-125,-126,-127,-128
 };// decrescent sawteeth wave
 
-const char noiseTable[] PROGMEM = {
-	108,5,-14,-53,85,15,75,-35,85,109,-55,97,-81,73,101,44,-126,72,73,-23,-96,3,72,-69,19,88,-41,19,-69,-2,103,-54,87,-121,-118,95,118,-104,-49,62,-47,-31,15,35,-58,86,15,97,114,14,-92,-81,118,-99,110,-52,73,-98,-77,-32,97,-77,52,5,-7,-99,-94,70,-99,-4,-30,126,-101,3,63,60,126,91,94,-98,55,109,64,-2,99,21,-34,-98,-34,-38,-95,85,-87,-105,-25,-90,-25,103,0,-6,-36,15,-1,59,-14,-89,-57,80,27,84,41,-63,87,-56,-19,-71,-73,-113,-35,-77,-97,-66,-40,103,106,88,78,-86,19,74,69,-115,-125,-83,75,117,-13,-103,34,-119,-80,8,103,60,73,56,103,7,61,54,-33,-69,-117,27,4,-93,106,51,51,-78,17,-61,-40,-113,12,-29,81,94,34,79,90,-68,-31,-51,8,50,-79,-30,86,41,-80,6,65,-80,-127,4,-9,31,17,73,125,9,-82,-62,112,25,-57,-39,127,56,123,-66,82,-96,-38,-98,-122,13,37,-86,-70,-92,-45,87,114,82,77,96,-124,-18,-92,-83,85,5,-120,107,-34,-22,98,-121,-33,-17,-49,-105,25,59,55,-106,-105,-28,-117,73,-86,-104,57,99,-35,77,63,10,-69,-19,-87,-33,95,-68
-};// "random" noise
 
 
 //enveloppes definition. There are 128 values
@@ -0,0 +1,279 @@
+#!/usr/bin/env python3
+"""
+song2h.py - converts a text or MIDI song into a header for SoundMachine::playSong().
+
+Usage:
+    song2h.py song.txt [-n name] [-o song_name.h]
+    song2h.py song.mid [-n name] [-o song_name.h] [--wave SQUARE] [--env 1] [--length 40]
+
+Text format, one command per line, '#' starts a comment:
+    bpm 120
+    note <channel> <note> <wave> <env> <length>    note is a MIDI number or a name (C4, F#3, Bb5), A4 == 69
+    stop <channel>
+    row <ticks>                                   ends the row, waits ticks (24 per quarter)
+    mark
+    repeat <count>                                plays again the section since the last mark count times
+    label <name>
+    jump <name>
+    end
+
+Several notes can be put on one line, separated by '|', and a row ends it:
+    note 0 C4 SQUARE 1 40 | note 1 E4 SIN 0 40 | row 12
+
+MIDI files are flattened: each note on is given the next channel, tempo changes become bpm commands.
+Note offs are ignored, the note length is given by the envelope (--length).
+"""
+
+import argparse
+import os
+import re
+import struct
+import sys
+
+SONG_NOTE = 0x00
+SONG_STOP = 0x10
+SONG_ROW = 0x20
+SONG_BPM = 0x30
+SONG_MARK = 0x40
+SONG_REPEAT = 0x50
+SONG_JUMP = 0x60
+SONG_END = 0xF0
+
+CHANNELS = 8
+TICKS_PER_QUARTER = 24
+
+WAVES = {"SIN": 0, "TRI": 1, "SQUARE": 2, "SAW": 3, "NOISE": 4}
+NOTES = {"C": 0, "D": 2, "E": 4, "F": 5, "G": 7, "A": 9, "B": 11}
+
+
+class SongError(Exception):
+    pass
+
+
+def parse_note(text):
+    if text.isdigit():
+        note = int(text)
+    else:
+        m = re.fullmatch(r"([A-Ga-g])([#b]?)(-?\d)", text)
+        if not m:
+            raise SongError("bad note '%s'" % text)
+        note = NOTES[m.group(1).upper()] + (int(m.group(3)) + 1) * 12
+        note += {"#": 1, "b": -1, "": 0}[m.group(2)]
+    if not 0 <= note <= 127:
+        raise SongError("note '%s' out of range" % text)
+    return note
+
+
+def parse_wave(text):
+    if text.upper() in WAVES:
+        return WAVES[text.upper()]
+    return parse_byte(text, 15)
+
+
+def parse_byte(text, top=255):
+    value = int(text, 0)
+    if not 0 <= value <= top:
+        raise SongError("value '%s' out of range [0..%d]" % (text, top))
+    return value
+
+
+class Song:
+    """Song being assembled: a list of (bytes, source) entries plus labels to resolve."""
+
+    def __init__(self):
+        self.entries = []
+        self.labels = {}
+        self.size = 0
+
+    def add(self, data, source):
+        self.entries.append((data, source))
+        self.size += len(data) if not isinstance(data, str) else 3
+
+    def note(self, channel, note, wave, env, length):
+        self.add([SONG_NOTE | channel, note, (wave << 4) | env, length],
+                 "S_NOTE(%d, %d, %d, %d, %d)" % (channel, note, wave, env, length))
+
+    def row(self, ticks):
+        # Rows longer than 255 ticks are split
+        while ticks > 255:
+            self.add([SONG_ROW, 255], "S_ROW(255)")
+            ticks -= 255
+        if ticks:
+            self.add([SONG_ROW, ticks], "S_ROW(%d)" % ticks)
+
+    def bpm(self, bpm):
+        bpm = min(max(int(round(bpm)), 20), 239)
+        self.add([SONG_BPM, bpm], "S_BPM(%d)" % bpm)
+
+    def assemble(self):
+        out = []
+        for data, source in self.entries:
+            if isinstance(data, str):
+                if data not in self.labels:
+                    raise SongError("unknown label '%s'" % data)
+                offset = self.labels[data]
+                data = [SONG_JUMP, offset & 0xFF, offset >> 8]
+                source = "S_JUMP(%d)" % offset
+            out.append((data, source))
+        if not self.entries or self.entries[-1][0] != [SONG_END]:
+            out.append(([SONG_END], "S_END"))
+        return out
+
+
+def parse_text(path):
+    song = Song()
+    with open(path) as f:
+        for number, line in enumerate(f, 1):
+            line = line.split("#", 1)[0]
+            for command in line.split("|"):
+                words = command.split()
+                if not words:
+                    continue
+                try:
+                    parse_command(song, words)
+                except (SongError, ValueError, IndexError) as e:
+                    raise SongError("%s:%d: %s" % (path, number, e))
+    return song
+
+
+def parse_command(song, words):
+    name, args = words[0].lower(), words[1:]
+    if name == "note":
+        song.note(parse_byte(args[0], CHANNELS - 1), parse_note(args[1]), parse_wave(args[2]),
+                  parse_byte(args[3], 15), parse_byte(args[4], 127))
+    elif name == "stop":
+        channel = parse_byte(args[0], CHANNELS - 1)
+        song.add([SONG_STOP | channel], "S_STOP(%d)" % channel)
+    elif name == "row":
+        song.row(int(args[0], 0))
+    elif name == "bpm":
+        song.bpm(int(args[0], 0))
+    elif name == "mark":
+        song.add([SONG_MARK], "S_MARK")
+    elif name == "repeat":
+        count = parse_byte(args[0])
+        song.add([SONG_REPEAT, count], "S_REPEAT(%d)" % count)
+    elif name == "label":
+        song.labels[args[0]] = song.size
+    elif name == "jump":
+        song.add(args[0], None)
+    elif name == "end":
+        song.add([SONG_END], "S_END")
+    else:
+        raise SongError("unknown command '%s'" % name)
+
+
+def read_varlen(data, pos):
+    value = 0
+    while True:
+        byte = data[pos]
+        pos += 1
+        value = (value << 7) | (byte & 0x7F)
+        if not byte & 0x80:
+            return value, pos
+
+
+def parse_midi(path, wave, env, length):
+    with open(path, "rb") as f:
+        data = f.read()
+    if data[:4] != b"MThd":
+        raise SongError("%s: not a MIDI file" % path)
+    _, _, tracks, division = struct.unpack(">IHHH", data[4:14])
+    if division & 0x8000:
+        raise SongError("%s: SMPTE time division is not supported" % path)
+
+    # Gather (time, kind, value) from all tracks
+    events = []
+    pos = 8 + struct.unpack(">I", data[4:8])[0]
+    for _ in range(tracks):
+        if data[pos:pos + 4] != b"MTrk":
+            raise SongError("%s: bad track header" % path)
+        end = pos + 8 + struct.unpack(">I", data[pos + 4:pos + 8])[0]
+        pos += 8
+        time = 0
+        status = 0
+        while pos < end:
+            delta, pos = read_varlen(data, pos)
+            time += delta
+            if data[pos] & 0x80:
+                status = data[pos]
+                pos += 1
+            if status == 0xFF:
+                kind = data[pos]
+                size, pos = read_varlen(data, pos + 1)
+                if kind == 0x51:
+                    tempo = int.from_bytes(data[pos:pos + 3], "big")
+                    events.append((time, "bpm", 60000000.0 / tempo))
+                pos += size
+            elif status in (0xF0, 0xF7):
+                size, pos = read_varlen(data, pos)
+                pos += size
+            else:
+                kind = status & 0xF0
+                if kind in (0xC0, 0xD0):
+                    pos += 1
+                else:
+                    if kind == 0x90 and data[pos + 1] > 0:
+                        events.append((time, "note", data[pos]))
+                    pos += 2
+        pos = end
+
+    song = Song()
+    channel = 0
+    last = 0
+    for time, kind, value in sorted(events, key=lambda e: (e[0], e[1] != "bpm")):
+        tick = int(round(time * TICKS_PER_QUARTER / float(division)))
+        song.row(tick - last)
+        last = max(last, tick)
+        if kind == "bpm":
+            song.bpm(value)
+        else:
+            song.note(channel, value, wave, env, length)
+            channel = (channel + 1) % CHANNELS
+    song.row(TICKS_PER_QUARTER)
+    return song
+
+
+def write_header(out, name, entries):
+    size = sum(len(data) for data, _ in entries)
+    guard = name.upper() + "_H"
+    out.write("// Generated by tools/song2h.py, %d bytes\n\n" % size)
+    out.write("#ifndef %s\n#define %s\n\n" % (guard, guard))
+    out.write("#include <avr/pgmspace.h>\n#include \"song.h\"\n\n")
+    out.write("const unsigned char %s[] PROGMEM = {\n" % name)
+    for _, source in entries:
+        out.write("\t%s,\n" % source)
+    out.write("};\n\n#endif\n")
+
+
+def main():
+    parser = argparse.ArgumentParser(description="Converts a text or MIDI song for SoundMachine::playSong()")
+    parser.add_argument("input")
+    parser.add_argument("-n", "--name", help="array name (default: song_<file name>)")
+    parser.add_argument("-o", "--output", help="header to write (default: stdout)")
+    parser.add_argument("--wave", default="SQUARE", help="waveform for MIDI notes")
+    parser.add_argument("--env", default="1", help="enveloppe for MIDI notes")
+    parser.add_argument("--length", default="40", help="length for MIDI notes")
+    args = parser.parse_args()
+
+    base = os.path.splitext(os.path.basename(args.input))[0]
+    name = args.name or "song_" + re.sub(r"\W", "_", base)
+
+    try:
+        if args.input.lower().endswith((".mid", ".midi")):
+            song = parse_midi(args.input, parse_wave(args.wave), parse_byte(args.env, 15), parse_byte(args.length, 127))
+        else:
+            song = parse_text(args.input)
+        entries = song.assemble()
+    except SongError as e:
+        sys.exit("song2h: %s" % e)
+
+    if args.output:
+        with open(args.output, "w") as out:
+            write_header(out, name, entries)
+    else:
+        write_header(sys.stdout, name, entries)
+
+
+if __name__ == "__main__":
+    main()
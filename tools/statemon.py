@@ -0,0 +1,112 @@
+#!/usr/bin/env python3
+"""
+statemon.py - shows the frames sent by SoundMachine::dumpState().
+
+Usage:
+    statemon.py /dev/ttyACM0 [-b 115200]     reads a serial port (needs pyserial)
+    statemon.py capture.bin                  reads a file captured from the serial port
+
+Each frame is printed as one line: ticks, ticks in the beat, number of active channels, then one column per channel
+with its amplitude bar, note and age in ticks. A summary of polyphony usage is printed on exit.
+Frames with a bad checksum or out of range values are dropped, and the reader looks for the next sync.
+"""
+
+import argparse
+import os
+import sys
+
+STATE_SYNC = b"\xA5\x5A"
+CHANNELS = 8
+FRAME_SIZE = 7 + CHANNELS * 5
+WAVES = "ITQWN"                 # SIN, TRI, SQUARE, SAW, NOISE
+BARS = " .:-=+*#%@"
+
+
+def open_input(path, baud):
+    if os.path.isfile(path):
+        return open(path, "rb")
+    try:
+        import serial
+    except ImportError:
+        sys.exit("statemon: pyserial is needed to read %s" % path)
+    return serial.Serial(path, baud)
+
+
+def valid(frame):
+    """Checks the checksum and the values of a frame, to tell a real frame from sync bytes found in a payload."""
+    if frame[:2] != STATE_SYNC or sum(frame[2:-1]) & 0xFF != frame[-1]:
+        return False
+    for i in range(CHANNELS):
+        amp, env, note, wave, age = frame[6 + i * 5:11 + i * 5]
+        if env > 128 or note > 127 or wave >= len(WAVES):
+            return False
+    return True
+
+
+def frames(stream):
+    """Yields the valid frames found in stream. On a bad frame, skips one byte and looks for the next sync."""
+    buf = bytearray()
+    while True:
+        data = stream.read(FRAME_SIZE)
+        if not data:
+            return
+        buf += data
+        while len(buf) >= FRAME_SIZE:
+            start = buf.find(STATE_SYNC)
+            if start < 0:
+                del buf[:-1]
+                break
+            del buf[:start]
+            if len(buf) < FRAME_SIZE:
+                break
+            if valid(buf[:FRAME_SIZE]):
+                yield bytes(buf[:FRAME_SIZE])
+                del buf[:FRAME_SIZE]
+            else:
+                del buf[0]
+
+
+def decode(frame):
+    ticks = frame[2] | (frame[3] << 8)
+    beat = frame[4]
+    active = frame[5]
+    voices = []
+    for i in range(CHANNELS):
+        amp, env, note, wave, age = frame[6 + i * 5:11 + i * 5]
+        voices.append((bool(active & (1 << i)), amp, env, note, wave, age))
+    return ticks, beat, voices
+
+
+def show(ticks, beat, voices):
+    columns = []
+    for active, amp, env, note, wave, age in voices:
+        if active:
+            wave = WAVES[wave]
+            columns.append("%s%s%3d %3d" % (BARS[amp * (len(BARS) - 1) // 255], wave, note, age))
+        else:
+            columns.append("  ---    ")
+    count = sum(v[0] for v in voices)
+    print("%5d %2d %d | %s" % (ticks, beat, count, " | ".join(columns)))
+    return count
+
+
+def main():
+    parser = argparse.ArgumentParser(description="Shows the frames sent by SoundMachine::dumpState()")
+    parser.add_argument("input", help="serial port or capture file")
+    parser.add_argument("-b", "--baud", type=int, default=115200)
+    args = parser.parse_args()
+
+    usage = [0] * (CHANNELS + 1)
+    try:
+        for frame in frames(open_input(args.input, args.baud)):
+            usage[show(*decode(frame))] += 1
+    except KeyboardInterrupt:
+        pass
+
+    total = sum(usage)
+    if total:
+        print("\nactive channels: " + "  ".join("%d:%d%%" % (n, 100 * c // total) for n, c in enumerate(usage)))
+
+
+if __name__ == "__main__":
+    main()
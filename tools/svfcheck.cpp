@@ -0,0 +1,132 @@
+/*
+ * svfcheck.cpp - runs the filter of svf.h on the host and checks it.
+ *
+ * Build and run from the library folder:
+ *     g++ -I. tools/svfcheck.cpp -o svfcheck && ./svfcheck
+ *
+ * The filter state type is replaced by Checked, which computes in 64 bits and fails if any value, intermediate
+ * products included, does not fit in the 32 bits long of the AVR. Results are otherwise the same as on the AVR.
+ *
+ * Each cutoff, resonance and mode is fed square and saw waves at several periods, then silence: the output must come
+ * back to 0. Then the filter is fed a full scale sine at its cutoff with the highest resonance, its worst case.
+ * Returns 1 on any failure.
+ */
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+
+//64 bits integer that fails as soon as its value gets out of the 32 bits range
+class Checked{
+  public:
+    Checked(int64_t v = 0) : value(check(v)){}
+
+    explicit operator int() const{ return (int)value; }
+
+    Checked operator+(const Checked &o) const{ return Checked(value + o.value); }
+    Checked operator-(const Checked &o) const{ return Checked(value - o.value); }
+    Checked operator*(const Checked &o) const{ return Checked(value * o.value); }
+    Checked operator<<(int n) const{ return Checked(value * ((int64_t)1 << n)); }
+    Checked operator>>(int n) const{ return Checked(value >> n); }
+    Checked &operator+=(const Checked &o){ value = check(value + o.value); return *this; }
+
+    static int64_t peak;
+
+  private:
+    static int64_t check(int64_t v){
+        int64_t a = v < 0 ? -v : v;
+        if(a > peak){
+            peak = a;
+        }
+        if(v > INT32_MAX || v < INT32_MIN){
+            printf("FAILED: %lld does not fit in 32 bits\n", (long long)v);
+            exit(1);
+        }
+        return v;
+    }
+
+    int64_t value;
+};
+
+int64_t Checked::peak = 0;
+
+#define SVF_INT Checked
+#include "svf.h"
+
+//ISR input range is [-256..252], 256 is used as the worst case
+#define AMP_MAX 256
+
+static int square(long i, long period, int amp){
+	return (i / period) % 2 ? amp : -amp;
+}
+
+static int saw(long i, long period, int amp){
+	return (int)((i % period) * 2 * amp / period) - amp;
+}
+
+static int settleCheck(void){
+	const unsigned char fs[] = {1, 2, 3, 5, 10, 20, 50, 100, FILTER_F_MAX};
+	const unsigned char qs[] = {FILTER_Q_MIN, 64, 255};
+	const long periods[] = {3, 7, 200, 3000};
+	const int amps[] = {60, AMP_MAX};
+	int failures = 0;
+
+	for(unsigned fi = 0; fi < sizeof(fs); fi++){
+		for(unsigned qi = 0; qi < sizeof(qs); qi++){
+			for(unsigned char mode = FILTER_LOWPASS; mode <= FILTER_BANDPASS; mode++){
+				for(unsigned pi = 0; pi < sizeof(periods) / sizeof(periods[0]); pi++){
+					for(unsigned ai = 0; ai < sizeof(amps) / sizeof(amps[0]); ai++){
+						for(int wave = 0; wave < 2; wave++){
+							Checked low = 0;
+							Checked band = 0;
+							int out = 0;
+							long i;
+
+							for(i = 0; i < 40000; i++){
+								int in = wave ? saw(i, periods[pi], amps[ai]) : square(i, periods[pi], amps[ai]);
+								svfProcess(low, band, fs[fi], qs[qi], mode, in);
+							}
+							//lowest cutoffs take a few seconds to settle
+							for(i = 0; i < 400000; i++){
+								out = svfProcess(low, band, fs[fi], qs[qi], mode, 0);
+							}
+
+							if(out != 0){
+								printf("f=%d q=%d mode=%d %s period=%ld amp=%d: %d after silence\n",
+									fs[fi], qs[qi], mode, wave ? "saw" : "square", periods[pi], amps[ai], out);
+								failures++;
+							}
+						}
+					}
+				}
+			}
+		}
+	}
+	return failures;
+}
+
+//Full scale sine at the cutoff frequency, where the resonance gain is the highest
+static void resonanceCheck(void){
+	for(int f = 100; f <= FILTER_F_MAX; f++){
+		for(int q = FILTER_Q_MIN; q <= FILTER_Q_MIN + 10; q++){
+			double fc = asin(f / 512.0) / M_PI;
+			Checked low = 0;
+			Checked band = 0;
+			for(long i = 0; i < 20000; i++){
+				int in = (int)lround(AMP_MAX * sin(2 * M_PI * fc * i));
+				svfProcess(low, band, f, q, FILTER_BANDPASS, in);
+			}
+		}
+	}
+}
+
+int main(void){
+	resonanceCheck();
+	printf("peak at resonance: %.0f%% of the 32 bits range\n", 100.0 * Checked::peak / INT32_MAX);
+
+	int failures = settleCheck();
+
+	printf("%s\n", failures ? "FAILED" : "ok");
+	return failures ? 1 : 0;
+}